@@ -85,14 +85,16 @@ const u8 NUM_REGISTERS = sizeof(REGISTERS) / sizeof(REGISTERS[0]);
 const AsmOpcode *FindInstructionNameOnly(const StringView name)
 {
     for (u8 i = 0; i != NUM_INSTRUCTIONS; ++i)
-        if (!memcmp(INSTRUCTION_SET[i].name, name.name, name.length))
+        if (strlen(INSTRUCTION_SET[i].name) == name.length &&
+            !memcmp(INSTRUCTION_SET[i].name, name.name, name.length))
             return &INSTRUCTION_SET[i];
     return NULL;
 }
 size_t FindRegisterIndex(const StringView name)
 {
     for (u8 i = 0; i != NUM_REGISTERS; ++i)
-        if (!memcmp(REGISTERS[i].name, name.name, name.length))
+        if (strlen(REGISTERS[i].name) == name.length &&
+            !memcmp(REGISTERS[i].name, name.name, name.length))
             return i;
     return (size_t)-1;
 }
@@ -128,11 +130,12 @@ CLASS(AsmInstruc)
     StringView name;
     vector_AsmArg args;
     u8 bitsize_estimate;
+    u64 offset;  // first byte emitted for this instruction
 };
 
 CLASS(AsmLabel)
 {
-    StringView name;
+    u32 name;  // interned id of the label's token
     u64 offset;
 };
 
@@ -141,8 +144,19 @@ VECTOR_TYPE(AsmLabel);
 
 VECTOR_TYPE(u8);
 
+// one row of the offset -> line table, sorted by offset
+CLASS(AsmLineMapEntry)
+{
+    u32 offset;
+    u32 line;
+};
+VECTOR_TYPE(AsmLineMapEntry);
+
 CLASS(AsmUnit)
 {
+    STRING source;
+    vector_size_t lines;  // line starts of source, for error positions and listings
+
     vector_AsmInstruc instructions;
     vector_AsmLabel labels;
 
@@ -156,12 +170,8 @@ CLASS(AsmUnit)
 size_t FindLabelIndex(AsmUnit *unit, StringView s)
 {
     for (size_t i = 0; i != unit->labels.size; ++i)
-    {
-        if (unit->labels.at(i).name.length != s.length)
-            continue;
-        if (!memcmp(unit->labels.at(i).name.name, s.name, s.length))
+        if (unit->labels.at(i).name == s.id)
             return i;
-    }
     return (size_t)-1;
 }
 
@@ -235,7 +245,12 @@ vector_AsmArg ParseArgs(AsmUnit *unit, const vector_Token tokens, size_t *index)
             }
             else
             {
-                printf("Unknown type '%.*s'\n", tokens.at(i).length, tokens.at(i).name);
+                const SourcePos pos = TokenPos(unit->lines, unit->source, tokens.at(i));
+                printf("%u:%u: Unknown type '%.*s'\n",
+                       pos.line,
+                       pos.column,
+                       (int)tokens.at(i).length,
+                       tokens.at(i).name);
             }
             ++i;
         }
@@ -288,7 +303,7 @@ void PutLabels(AsmUnit *unit, const vector_Token tokens)
         if (tokens.at(i).name[0] == ':')
         {
             AsmLabel label;
-            label.name = tokens.at(i - 1);
+            label.name = tokens.at(i - 1).id;
 
             PUSH(unit->labels, label);
         }
@@ -311,7 +326,7 @@ const AsmOpcode *FindInstruction(AsmInstruc *ins, AsmUnit *unit)
     {
         const AsmOpcode *op = &INSTRUCTION_SET[i];
 
-        u8 olen = strlen(op->name);
+        size_t olen = strlen(op->name);
 
         if (ins->name.length != olen)
             continue;
@@ -371,11 +386,16 @@ void EncodeInstruction(AsmUnit *unit, size_t index)
 
     if (!op)
     {
-        printf("Failed to find instruction profile for '%.*s'\n", ins->name.length, ins->name.name);
+        const SourcePos pos = TokenPos(unit->lines, unit->source, ins->name);
+        printf("%u:%u: Failed to find instruction profile for '%.*s'\n",
+               pos.line,
+               pos.column,
+               (int)ins->name.length,
+               ins->name.name);
         exit(EXIT_FAILURE);
     }
 
-    printf("'%.*s' has opcode %02hhX\n", ins->name.length, ins->name.name, op->code);
+    printf("'%.*s' has opcode %02hhX\n", (int)ins->name.length, ins->name.name, op->code);
 
     u8 opcode = op->code;
     // todo: prefixes
@@ -436,6 +456,7 @@ void EncodeBytes(AsmUnit *unit)
     for (size_t i = 0; i < unit->instructions.size; ++i)
     {
         AsmInstruc *ins = &unit->instructions.at(i);
+        ins->offset = unit->bytes.size;
         switch (ins->type)
         {
         case ASM_LABEL:
@@ -460,6 +481,81 @@ void EncodeBytes(AsmUnit *unit)
     // unit->has_shrinkables = true;
 }
 
+u64 InstructionEnd(AsmUnit *unit, size_t index)
+{
+    return index + 1 < unit->instructions.size ? unit->instructions.at(index + 1).offset
+                                               : unit->bytes.size;
+}
+
+void WriteListing(AsmUnit *unit, const STRING path)
+{
+    FILE *out;
+    if (fopen_s(&out, path, "wt"))
+    {
+        printf("Failed to open listing file '%s'\n", path);
+        return;
+    }
+
+    for (size_t i = 0; i != unit->instructions.size; ++i)
+    {
+        AsmInstruc *ins = &unit->instructions.at(i);
+        if (ins->type == ASM_DIREC)
+            continue;
+
+        fprintf(out, "%08llX  ", (unsigned long long)ins->offset);
+
+        const u64 end = InstructionEnd(unit, i);
+        int written = 0;
+        for (u64 b = ins->offset; b != end; ++b)
+            written += fprintf(out, "%02hhX ", unit->bytes.at(b));
+        fprintf(out, "%*s", written < 24 ? 24 - written : 0, "");
+
+        // echo the whole source line the instruction came from
+        const SourcePos pos = TokenPos(unit->lines, unit->source, ins->name);
+        const STRING line = unit->source + unit->lines.at(pos.line - 1);
+        size_t length = strcspn(line, "\n");
+        if (length && line[length - 1] == '\r')
+            --length;
+        fprintf(out, "%5u  %.*s\n", pos.line, (int)length, line);
+    }
+
+    fclose(out);
+}
+
+void WriteLineMap(AsmUnit *unit, const STRING path)
+{
+    FILE *out;
+    if (fopen_s(&out, path, "wb"))
+    {
+        printf("Failed to open line map file '%s'\n", path);
+        return;
+    }
+
+    // instructions are emitted in order, so offsets come out sorted. only the first
+    // instruction of each run on the same line gets an entry
+    vector_AsmLineMapEntry map = MAKE_VECTOR(AsmLineMapEntry);
+    for (size_t i = 0; i != unit->instructions.size; ++i)
+    {
+        AsmInstruc *ins = &unit->instructions.at(i);
+        if (ins->type != ASM_INSTR || InstructionEnd(unit, i) == ins->offset)
+            continue;
+
+        AsmLineMapEntry entry = {
+            .offset = ins->offset,
+            .line = TokenPos(unit->lines, unit->source, ins->name).line,
+        };
+        if (map.size && map.at(map.size - 1).line == entry.line)
+            continue;
+        PUSH(map, entry);
+    }
+
+    const u32 count = map.size;
+    fwrite(&count, sizeof(count), 1, out);
+    fwrite(map.data, sizeof(AsmLineMapEntry), map.size, out);
+    fclose(out);
+    free(map.data);
+}
+
 // void EstimateLabels(AsmUnit *unit)
 // {
 //     size_t count = 0;
@@ -487,10 +583,16 @@ int main(void)
 {
     printf("\n");
 
-    STRING content = DumpFile("../tests/test.asm");
+    size_t length;
+    STRING content = DumpFile("../tests/test.asm", &length);
+    if (!content)
+        return EXIT_FAILURE;
 
-    vector_Token tokens = ReadTokens(content);
+    StringPool pool = MakeStringPool();
+    vector_Token tokens = ReadTokens(&pool, content);
     AsmUnit unit = {
+        .source = content,
+        .lines = IndexLines(content, length),
         .instructions = MAKE_VECTOR(AsmInstruc),
         .labels = MAKE_VECTOR(AsmLabel),
         .has_shrinkables = true,
@@ -500,7 +602,10 @@ int main(void)
     PutLabels(&unit, tokens);
 
     for (size_t i = 0; i != unit.labels.size; ++i)
-        printf("label '%.*s'\n", unit.labels.at(i).name.length, unit.labels.at(i).name.name);
+    {
+        const StringView *name = &pool.strings.at(unit.labels.at(i).name);
+        printf("label '%.*s'\n", (int)name->length, name->name);
+    }
 
     ParseInstructions(&unit, tokens);
 
@@ -549,5 +654,8 @@ int main(void)
     for (size_t i = 0; i != unit.bytes.size; ++i)
         printf("%02hhX\t", unit.bytes.at(i));
 
+    WriteListing(&unit, "../tests/test.lst");
+    WriteLineMap(&unit, "../tests/test.map");
+
     return 0;
 }
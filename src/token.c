@@ -1,6 +1,72 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "token.h"
 
-vector_Token ReadTokens(STRING in)
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+StringPool MakeStringPool(void)
+{
+    const size_t capacity = 64;
+    return (StringPool){
+        .strings = MAKE_VECTOR(StringView),
+        .slots = calloc(capacity, sizeof(u32)),
+        .capacity = capacity,
+    };
+}
+
+static u32 HashString(const char *name, u32 length)
+{
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i != length; ++i)
+        hash = (hash ^ (u8)name[i]) * 16777619u;
+    return hash;
+}
+
+static void GrowStringPool(StringPool *pool)
+{
+    free(pool->slots);
+    pool->capacity *= 2;
+    pool->slots = calloc(pool->capacity, sizeof(u32));
+    for (size_t i = 0; i != pool->strings.size; ++i)
+    {
+        const StringView *s = &pool->strings.at(i);
+        size_t slot = HashString(s->name, s->length) & (pool->capacity - 1);
+        while (pool->slots[slot])
+            slot = (slot + 1) & (pool->capacity - 1);
+        pool->slots[slot] = i + 1;
+    }
+}
+
+u32 InternString(StringPool *pool, char *name, u32 length)
+{
+    size_t slot = HashString(name, length) & (pool->capacity - 1);
+    while (pool->slots[slot])
+    {
+        const StringView *s = &pool->strings.at(pool->slots[slot] - 1);
+        if (s->length == length && !memcmp(s->name, name, length))
+            return s->id;
+        slot = (slot + 1) & (pool->capacity - 1);
+    }
+
+    const StringView s = {.name = name, .length = length, .id = pool->strings.size};
+    PUSH(pool->strings, s);
+    pool->slots[slot] = s.id + 1;
+
+    // keep the load factor under a half so probe chains stay short
+    if (pool->strings.size * 2 > pool->capacity)
+        GrowStringPool(pool);
+    return s.id;
+}
+
+vector_Token ReadTokens(StringPool *pool, STRING in)
 {
     vector_Token tokens = MAKE_VECTOR(Token);
     size_t i = 0;
@@ -26,21 +92,98 @@ vector_Token ReadTokens(STRING in)
             token.length = 1;
             ++i;
         }
+        token.id = InternString(pool, token.name, token.length);
         PUSH(tokens, token);
     }
     return tokens;
 }
 
-STRING DumpFile(const STRING path)
+STRING DumpFile(const STRING path, size_t *length)
 {
     FILE *in;
-    fopen_s(&in, path, "rt");
-    fseek(in, 0l, SEEK_END);
-    long length = ftell(in);
-    fseek(in, 0l, SEEK_SET);
-    STRING content = malloc(sizeof(char) * length + 1);
-    size_t read_length = fread(content, sizeof(char), length, in);
+    if (fopen_s(&in, path, "rt"))
+    {
+        printf("Failed to open '%s'\n", path);
+        return NULL;
+    }
+
+    // long is 32 bits on windows, so size the file with the 64 bit variants
+    i64 size = -1;
+    if (!fseek64(in, 0, SEEK_END))
+        size = ftell64(in);
+    if (size < 0 || (u64)size >= SIZE_MAX || fseek64(in, 0, SEEK_SET))
+    {
+        printf("Failed to get the size of '%s'\n", path);
+        fclose(in);
+        return NULL;
+    }
+
+    STRING content = malloc(sizeof(char) * size + 1);
+    if (!content)
+    {
+        printf("Failed to allocate %llu bytes for '%s'\n", (unsigned long long)size + 1, path);
+        fclose(in);
+        return NULL;
+    }
+
+    // text mode may translate line endings, so the read can come up short
+    const size_t read_length = fread(content, sizeof(char), size, in);
+    if (ferror(in))
+    {
+        printf("Failed to read '%s'\n", path);
+        free(content);
+        fclose(in);
+        return NULL;
+    }
     content[read_length] = 0;
     fclose(in);
+
+    if (length)
+        *length = read_length;
     return content;
 }
+
+vector_size_t IndexLines(const STRING in, size_t length)
+{
+    vector_size_t lines = MAKE_VECTOR(size_t);
+    PUSH(lines, 0);
+    size_t i = 0;
+#ifdef __SSE2__
+    // compare 16 bytes at a time and only visit the newlines in each chunk
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= length; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128((const __m128i *)&in[i]);
+        u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while (mask)
+        {
+            PUSH(lines, i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < length; ++i)
+        if (in[i] == '\n')
+            PUSH(lines, i + 1);
+    return lines;
+}
+
+SourcePos FindSourcePos(const vector_size_t lines, size_t offset)
+{
+    // find the last line starting at or before the offset
+    size_t lo = 0, hi = lines.size;
+    while (hi - lo > 1)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (lines.at(mid) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (SourcePos){.line = lo + 1, .column = offset - lines.at(lo) + 1};
+}
+
+SourcePos TokenPos(const vector_size_t lines, const STRING in, const Token token)
+{
+    return FindSourcePos(lines, token.name - in);
+}
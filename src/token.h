@@ -4,12 +4,42 @@
 CLASS(StringView)
 {
     char *name;
-    u8 length;
+    u32 length;
+    u32 id;  // from InternString, equal ids mean equal text
 };
 StringView typedef Token;
 
 VECTOR_TYPE(Token);
+VECTOR_TYPE(StringView);
 
-STRING DumpFile(const STRING path);
+// deduplicates names so later stages can compare them by id
+CLASS(StringPool)
+{
+    vector_StringView strings;  // indexed by id
+    u32 *slots;                 // open addressed hash table of id + 1, 0 if empty
+    size_t capacity;
+};
+
+// 1-based line and column of a byte in the source
+CLASS(SourcePos)
+{
+    u32 line;
+    u32 column;
+};
+
+// start offset of every line, in ascending order
+VECTOR_TYPE(size_t);
+
+STRING DumpFile(const STRING path, size_t *length);
+
+StringPool MakeStringPool(void);
+
+u32 InternString(StringPool *pool, char *name, u32 length);
+
+vector_Token ReadTokens(StringPool *pool, const STRING in);
+
+vector_size_t IndexLines(const STRING in, size_t length);
+
+SourcePos FindSourcePos(const vector_size_t lines, size_t offset);
 
-vector_Token ReadTokens(const STRING in);
\ No newline at end of file
+SourcePos TokenPos(const vector_size_t lines, const STRING in, const Token token);
\ No newline at end of file